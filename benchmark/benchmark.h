@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+typedef std::chrono::steady_clock Clock;
+
+const int kDefaultCount = 100000;
+const size_t kMessageSizes[] = {16, 128, 1024};
+// A paced burst is small enough to fit in the logger queue,
+// so it measures the latency of a call that never blocks.
+const int kPacedBurst = 100;
+const int kPacedCount = 10000;
+const std::chrono::milliseconds kPacedPause(10);
+const std::chrono::milliseconds kSettleTime(200);
+
+struct Options {
+    int maxThreads;
+    int count;
+    int formatThreads;
+    const char* output;
+};
+
+struct Result {
+    const char* name;
+    int threads;
+    size_t messageSize;
+    int countPerThread;
+    int count;
+    double throughput; // messages per second, or negative if not measured
+    uint64_t p50;      // nanoseconds
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+inline void PrintUsage(const char* program) {
+    printf("usage: %s [-t max threads] [-n count per thread] [-f format threads] [-o csv file]\n", program);
+}
+
+inline bool ParseOptions(int argc, char** argv, Options* opts) {
+    opts->maxThreads = std::max(1, (int) std::thread::hardware_concurrency());
+    opts->count = kDefaultCount;
+    opts->formatThreads = 1;
+    opts->output = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            PrintUsage(argv[0]);
+            return false;
+        }
+        const char* val = argv[++i];
+        if (strcmp(argv[i - 1], "-t") == 0) {
+            opts->maxThreads = std::max(1, atoi(val));
+        } else if (strcmp(argv[i - 1], "-n") == 0) {
+            opts->count = std::max(1, atoi(val));
+        } else if (strcmp(argv[i - 1], "-f") == 0) {
+            opts->formatThreads = std::max(1, atoi(val));
+        } else if (strcmp(argv[i - 1], "-o") == 0) {
+            opts->output = val;
+        } else {
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns 1, 2, 4, ... up to and including maxThreads.
+inline std::vector<int> ThreadCounts(int maxThreads) {
+    std::vector<int> counts;
+    for (int n = 1; n < maxThreads; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+class Report final {
+public:
+    // formatThreads is 0 for a library that has no such setting.
+    Report(const char* library, int formatThreads, const char* filename)
+            : m_library(library), m_formatThreads(formatThreads), m_output(nullptr) {
+        if (filename != nullptr) {
+            m_output = fopen(filename, "w");
+            if (m_output == nullptr) {
+                fprintf(stderr, "ERROR: benchmark: Failed to open file: `%s`\n", filename);
+            } else {
+                fprintf(m_output, "library,format_threads,case,threads,message_size,count_per_thread,"
+                        "total_count,throughput,p50_ns,p99_ns,p999_ns,max_ns\n");
+            }
+        }
+        printf("%-8s %4s %-10s %7s %6s %9s %12s %9s %9s %9s %11s\n", "library", "fmt", "case", "threads",
+                "size", "count", "msgs/sec", "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)");
+    }
+
+    ~Report() {
+        if (m_output != nullptr) {
+            fclose(m_output);
+        }
+    }
+
+    Report(const Report&) = delete;
+    Report& operator=(const Report&) = delete;
+
+    void Add(const Result& r) {
+        char throughput[32] = "-";
+        if (r.throughput >= 0) {
+            snprintf(throughput, sizeof(throughput), "%.0f", r.throughput);
+        }
+        printf("%-8s %4d %-10s %7d %6lu %9d %12s %9llu %9llu %9llu %11llu\n", m_library, m_formatThreads,
+                r.name, r.threads, (unsigned long) r.messageSize, r.count, throughput,
+                (unsigned long long) r.p50, (unsigned long long) r.p99,
+                (unsigned long long) r.p999, (unsigned long long) r.max);
+        fflush(stdout);
+        if (m_output != nullptr) {
+            // an empty throughput field means it was not measured
+            fprintf(m_output, "%s,%d,%s,%d,%lu,%d,%d,%s,%llu,%llu,%llu,%llu\n", m_library, m_formatThreads,
+                    r.name, r.threads, (unsigned long) r.messageSize, r.countPerThread, r.count,
+                    r.throughput >= 0 ? throughput : "",
+                    (unsigned long long) r.p50, (unsigned long long) r.p99,
+                    (unsigned long long) r.p999, (unsigned long long) r.max);
+            fflush(m_output);
+        }
+    }
+
+private:
+    const char* m_library;
+    int m_formatThreads;
+    FILE* m_output;
+};
+
+inline uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    size_t index = (size_t) (p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+/**
+ * Call log(payload) count times on each of nThreads threads and time every call.
+ * If burst is positive, each thread pauses after every burst calls, and the
+ * throughput is not reported because it would only measure the pauses.
+ */
+template<typename F>
+Result Run(const char* name, int nThreads, size_t messageSize, int count, int burst, F log) {
+    std::string payload(messageSize, 'x');
+    std::vector<std::vector<uint64_t>> latencies(nThreads);
+    std::vector<std::thread> threads;
+    std::atomic<bool> started(false);
+    for (int t = 0; t < nThreads; t++) {
+        latencies[t].reserve(count);
+        threads.push_back(std::thread([&, t]() {
+            while (!started) {
+                std::this_thread::yield();
+            }
+            std::vector<uint64_t>& samples = latencies[t];
+            for (int i = 0; i < count; i++) {
+                if (burst > 0 && i > 0 && i % burst == 0) {
+                    std::this_thread::sleep_for(kPacedPause);
+                }
+                auto begin = Clock::now();
+                log(payload.c_str());
+                auto end = Clock::now();
+                samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            }
+        }));
+    }
+    auto start = Clock::now();
+    started = true;
+    for (std::thread& th : threads) {
+        th.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    all.reserve((size_t) count * nThreads);
+    for (auto& samples : latencies) {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    Result r;
+    r.name = name;
+    r.threads = nThreads;
+    r.messageSize = messageSize;
+    r.countPerThread = count;
+    r.count = count * nThreads;
+    r.throughput = burst > 0 ? -1 : (elapsed > 0 ? r.count / elapsed : 0);
+    r.p50 = percentile(all, 0.50);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    r.max = all.back();
+
+    // let the logger drain its queue before the next case
+    std::this_thread::sleep_for(kSettleTime);
+    return r;
+}
+
+/**
+ * Run every case at 1..maxThreads threads.
+ * `enabled` must log its argument and `disabled` must be filtered out by level.
+ */
+template<typename Enabled, typename Disabled>
+void RunSuite(const Options& opts, Report* report, Enabled enabled, Disabled disabled) {
+    for (int nThreads : ThreadCounts(opts.maxThreads)) {
+        report->Add(Run("disabled", nThreads, kMessageSizes[0], opts.count, 0, disabled));
+        for (size_t size : kMessageSizes) {
+            report->Add(Run("saturated", nThreads, size, opts.count, 0, enabled));
+        }
+        report->Add(Run("paced", nThreads, kMessageSizes[1], std::min(opts.count, kPacedCount),
+                kPacedBurst, enabled));
+    }
+}
+
+} // namespace benchmark
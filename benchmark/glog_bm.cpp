@@ -1,13 +1,21 @@
+#include "benchmark.h"
 #include "glog/logging.h"
 
-static const int kLoggingCount = 1000000;
+int main(int argc, char** argv) {
+    benchmark::Options opts;
+    if (!benchmark::ParseOptions(argc, argv, &opts)) {
+        return 1;
+    }
 
-int main(void) {
     FLAGS_logtostderr = 0;
     FLAGS_log_dir = "logs";
+    FLAGS_minloglevel = google::GLOG_INFO;
     google::InitGoogleLogging("glog");
-    for (int i = 0; i < kLoggingCount; i++) {
-        LOG(INFO) << i;
-    }
+
+    benchmark::Report report("glog", 0, opts.output);
+    benchmark::RunSuite(opts, &report,
+        [](const char* payload) { LOG(INFO) << payload; },
+        [](const char* payload) { VLOG(1) << payload; });
+    google::ShutdownGoogleLogging();
     return 0;
 }
@@ -1,11 +1,24 @@
+#include "benchmark.h"
 #include "logger.h"
 
-static const int kLoggingCount = 1000000;
+static const int64_t kMaxFileSize = 64 * 1048576L; // 64 MB
 
-int main(void) {
-    logger::Logger::InitFileLogger("logs/logger.txt");
-    for (int i = 0; i < kLoggingCount; i++) {
-        LOG_INFO("%d", i);
+int main(int argc, char** argv) {
+    benchmark::Options opts;
+    if (!benchmark::ParseOptions(argc, argv, &opts)) {
+        return 1;
     }
+
+    logger::SetFormatThreads((uint8_t) std::min(opts.formatThreads, 255));
+    logger::SetLevel(logger::LogLevel_INFO);
+    if (!logger::InitFileLogger("logs/logger.txt", kMaxFileSize, 1)) {
+        return 1;
+    }
+
+    benchmark::Report report("logger", opts.formatThreads, opts.output);
+    benchmark::RunSuite(opts, &report,
+        [](const char* payload) { LOG_INFO("%s", payload); },
+        [](const char* payload) { LOG_DEBUG("%s", payload); });
+    logger::Shutdown();
     return 0;
 }
@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include "logger.h"
+#if defined(_WIN32) || defined(_WIN64)
+ #include <process.h>
+#else
+ #include <spawn.h>
+ #include <sys/wait.h>
+ extern char** environ;
+#endif // defined(_WIN32) || defined(_WIN64)
+
+static const int kProcessCount = 200;
+
+// idle:     links the library but never logs, so no thread is started
+// eager:    starts the logging thread without logging, as every process
+//           did when the thread was started during static initialization
+// log:      logs one message and leaves the shutdown to the atexit handler
+// shutdown: logs one message and calls Shutdown()
+static const char* const kModes[] = {"idle", "eager", "log", "shutdown"};
+
+static int runChild(const char* mode) {
+    if (strcmp(mode, "idle") == 0) {
+        return 0;
+    }
+    if (strcmp(mode, "eager") == 0) {
+        return logger::InitConsoleLogger() ? 0 : 1;
+    }
+    if (!logger::InitFileLogger("logs/logger_startup.txt", 0, 0)) {
+        return 1;
+    }
+    LOG_INFO("%d", 0);
+    if (strcmp(mode, "shutdown") == 0) {
+        logger::Shutdown();
+    }
+    return 0;
+}
+
+// Runs the program without a shell, whose startup would hide the cost being measured.
+static bool spawn(const char* program, const char* mode) {
+    char* argv[] = {(char*) program, (char*) "--child", (char*) mode, nullptr};
+#if defined(_WIN32) || defined(_WIN64)
+    return _spawnv(_P_WAIT, program, argv) == 0;
+#else
+    pid_t pid;
+    if (posix_spawn(&pid, program, nullptr, nullptr, argv, environ) != 0) {
+        return false;
+    }
+    int status;
+    if (waitpid(pid, &status, 0) != pid) {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif // defined(_WIN32) || defined(_WIN64)
+}
+
+static double spawnAndTime(const char* program, const char* mode) {
+    auto start = std::chrono::steady_clock::now();
+    if (!spawn(program, mode)) {
+        fprintf(stderr, "Failed to run: `%s --child %s`\n", program, mode);
+        exit(1);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && strcmp(argv[1], "--child") == 0) {
+        return runChild(argv[2]);
+    }
+    int count = kProcessCount;
+    if (argc > 1) {
+        count = atoi(argv[1]);
+    }
+
+    // the modes take turns so that drift and warm-up affect all of them alike
+    const size_t nModes = sizeof(kModes) / sizeof(kModes[0]);
+    double total[nModes] = {};
+    spawnAndTime(argv[0], kModes[0]); // warm up
+    for (int i = 0; i < count; i++) {
+        for (size_t m = 0; m < nModes; m++) {
+            total[m] += spawnAndTime(argv[0], kModes[m]);
+        }
+    }
+    double idle = total[0] / count;
+    for (size_t m = 0; m < nModes; m++) {
+        double us = total[m] / count;
+        printf("%-8s %10.1f us/process %+10.1f us vs idle\n", kModes[m], us, us - idle);
+    }
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <fstream>
 #include <memory>
@@ -12,6 +14,7 @@
 #include <string>
 #include <thread>
 #include <vector>
+#include "logsearch.h"
 #if defined(_WIN32) || defined(_WIN64)
  #include <winsock2.h>
 #else
@@ -26,6 +29,7 @@ using namespace logger;
 
 const int64_t kDefaultMaxFileSize = 1048576L; // 1 MB
 const size_t kQueueCapacity = 1000;
+const size_t kReorderCapacity = 1000;
 
 #if defined(_WIN32) || defined(_WIN64)
 static int vasprintf(char** strp, const char* fmt, va_list ap) {
@@ -76,47 +80,66 @@ struct LogMessage {
     const char* file;
     uint32_t line;
     std::unique_ptr<char> content;
-    bool exited;
 };
 
 template<typename T>
 class LogQueue final {
 public:
-    explicit LogQueue(size_t capacity) : m_capacity(capacity) {}
+    explicit LogQueue(size_t capacity) : m_capacity(capacity), m_closed(false), m_popped(0) {}
     ~LogQueue() = default;
     LogQueue(const LogQueue&) = delete;
     LogQueue& operator=(const LogQueue&) = delete;
 
-    void Push(T&& element) {
+    // Returns false without taking the element if the queue has been closed.
+    bool Push(T&& element) {
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (isFull()) {
+        while (isFull() && !m_closed) {
             m_notfull.wait(lock);
         }
-        bool wasEmpty = isEmpty();
-        m_queue.push(std::move(element));
-        if (wasEmpty) {
-            m_notempty.notify_one();
+        if (m_closed) {
+            return false;
         }
+        m_queue.push(std::move(element));
+        // there may be several consumers waiting
+        m_notempty.notify_one();
+        return true;
     }
 
-    void Pop(T* element) {
+    // Returns false once the queue has been closed and drained.
+    // The sequence number counts the elements popped so far.
+    bool Pop(T* element, uint64_t* sequence = nullptr) {
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (isEmpty()) {
+        while (isEmpty() && !m_closed) {
             m_notempty.wait(lock);
         }
-        bool wasFull = isFull();
+        if (isEmpty()) {
+            return false;
+        }
         if (element != nullptr) {
             *element = std::move(m_queue.front());
         }
         m_queue.pop();
-        if (wasFull) {
-            m_notfull.notify_one();
+        if (sequence != nullptr) {
+            *sequence = m_popped;
         }
+        m_popped++;
+        // there may be several producers waiting
+        m_notfull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notfull.notify_all();
+        m_notempty.notify_all();
     }
 
 private:
     const size_t m_capacity;
     std::queue<T> m_queue;
+    bool m_closed;
+    uint64_t m_popped;
     std::mutex m_mutex;
     std::condition_variable m_notfull;
     std::condition_variable m_notempty;
@@ -132,58 +155,268 @@ private:
 
 struct LogWriter {
     virtual ~LogWriter() {}
-    virtual void Print(char level, const char* timestamp, const LogMessage& msg) = 0;
+    virtual void Print(const char* line, size_t size) = 0;
+    virtual void Flush() = 0;
 };
 
 class LogThread final {
 public:
-    LogThread() : m_queue(kQueueCapacity), m_thread(&LogThread::run, this) {}
-
-    ~LogThread() {
-        LogMessage exit = {};
-        exit.exited = true;
-        m_queue.Push(std::move(exit));
-        m_thread.join();
-    }
+    LogThread()
+            : m_queue(kQueueCapacity)
+            , m_threadCount(1)
+            , m_state(kIdle)
+            , m_stopping(false)
+            , m_dropped(0)
+            , m_nextSequence(0)
+            , m_waiting(0)
+            , m_formatted(false)
+            , m_draining(false) {}
 
     LogThread(const LogThread&) = delete;
     LogThread& operator=(const LogThread&) = delete;
 
     void Send(LogMessage&& msg) {
-        if (!msg.exited) {
-            m_queue.Push(std::move(msg));
+        if (m_state.load(std::memory_order_acquire) == kIdle) {
+            start();
         }
+        if (m_state.load(std::memory_order_acquire) == kRunning) {
+            if (m_queue.Push(std::move(msg))) {
+                return;
+            }
+        }
+        // the threads have been stopped, so write the message synchronously
+        // after the messages that were queued before
+        std::string line;
+        TimestampCache cache = {-1, {}};
+        format(msg, &cache, &line);
+        std::unique_lock<std::mutex> lock(m_writerMutex);
+        while (m_draining) {
+            m_drained.wait(lock);
+        }
+        print(line);
+        flush();
     }
 
     void AddWriter(std::unique_ptr<LogWriter> writer) {
-        m_writers.push_back(std::move(writer));
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_writers.push_back(std::move(writer));
+        }
+        start();
+    }
+
+    // Returns false if the threads have already been started.
+    bool SetThreadCount(uint8_t count) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (m_state.load(std::memory_order_relaxed) != kIdle) {
+            return false;
+        }
+        m_threadCount = count > 0 ? count : 1;
+        return true;
+    }
+
+    // Returns false if some messages were discarded because the timeout expired.
+    bool Stop(std::chrono::milliseconds timeout) {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (m_state.load(std::memory_order_relaxed) != kRunning) {
+            m_state.store(kStopped, std::memory_order_release);
+            return true;
+        }
+        m_deadline = std::chrono::steady_clock::now() + timeout;
+        m_stopping.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> writerLock(m_writerMutex);
+            m_draining = true;
+        }
+        m_state.store(kStopped, std::memory_order_release);
+        m_queue.Close();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+        if (m_printer.joinable()) {
+            {
+                std::lock_guard<std::mutex> commitLock(m_commitMutex);
+                m_formatted = true;
+            }
+            m_lineReady.notify_one();
+            m_printer.join();
+        }
+        {
+            std::lock_guard<std::mutex> writerLock(m_writerMutex);
+            flush();
+            m_draining = false;
+        }
+        m_drained.notify_all();
+        if (m_dropped > 0) {
+            fprintf(stderr, "ERROR: logger: Discarded %lu messages on shutdown\n", (unsigned long)m_dropped);
+            return false;
+        }
+        return true;
     }
 
 private:
+    enum State : uint8_t {
+        kIdle,
+        kRunning,
+        kStopped,
+    };
+
+    // `YY-MM-DD HH:MM:SS` of the last formatted second. Each thread has its
+    // own, so localtime_r, which takes a process-wide lock, is called at most
+    // once a second per thread.
+    struct TimestampCache {
+        time_t second;
+        char prefix[32];
+    };
+
     LogQueue<LogMessage> m_queue;
-    std::thread m_thread;
+    uint8_t m_threadCount;
+    std::vector<std::thread> m_threads;
+    std::mutex m_stateMutex;
+    std::atomic<State> m_state;
+    std::atomic<bool> m_stopping;
+    std::chrono::steady_clock::time_point m_deadline;
+    size_t m_dropped;
+    std::thread m_printer;
+    std::mutex m_commitMutex;
+    std::condition_variable m_committed;
+    std::condition_variable m_lineReady;
+    std::vector<std::string> m_lines; // indexed by sequence % kReorderCapacity
+    std::vector<bool> m_ready;
+    uint64_t m_nextSequence;
+    size_t m_waiting;
+    bool m_formatted;
+    std::mutex m_writerMutex;
+    bool m_draining;
+    std::condition_variable m_drained;
     std::vector<std::unique_ptr<LogWriter>> m_writers;
 
+    void start() {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (m_state.load(std::memory_order_relaxed) == kIdle) {
+            for (uint8_t i = 0; i < m_threadCount; i++) {
+                m_threads.push_back(std::thread(&LogThread::run, this));
+            }
+            if (m_threadCount > 1) {
+                m_lines.resize(kReorderCapacity);
+                m_ready.resize(kReorderCapacity, false);
+                m_printer = std::thread(&LogThread::printLines, this);
+            }
+            m_state.store(kRunning, std::memory_order_release);
+        }
+    }
+
     void run() {
-        while (true) {
-            LogMessage msg;
-            m_queue.Pop(&msg);
-            if (msg.exited) {
-                break;
+        LogMessage msg;
+        uint64_t sequence;
+        std::string line;
+        TimestampCache cache = {-1, {}};
+        while (m_queue.Pop(&msg, &sequence)) {
+            if (m_stopping.load(std::memory_order_acquire)
+                    && std::chrono::steady_clock::now() >= m_deadline) {
+                line.clear(); // an empty line marks a discarded message
+            } else {
+                format(msg, &cache, &line);
+            }
+            if (m_threadCount == 1) {
+                // a single thread pops the messages in order
+                std::lock_guard<std::mutex> lock(m_writerMutex);
+                print(line);
+            } else {
+                commit(sequence, &line);
             }
-            write(msg);
         }
     }
 
-    void write(const LogMessage& msg) {
-        char level = toCharacter(msg.level);
-        char timestamp[32];
-        toString(msg.timestamp, timestamp, sizeof(timestamp));
+    // Messages are formatted in parallel but printed in the order they were
+    // queued. A format thread only hands its line over to the printer thread,
+    // so it never waits for the writers unless the reorder buffer is full.
+    void commit(uint64_t sequence, std::string* line) {
+        std::unique_lock<std::mutex> lock(m_commitMutex);
+        while (sequence >= m_nextSequence + kReorderCapacity) {
+            m_waiting++;
+            m_committed.wait(lock);
+            m_waiting--;
+        }
+        size_t slot = (size_t)(sequence % kReorderCapacity);
+        m_lines[slot].swap(*line);
+        m_ready[slot] = true;
+        if (sequence == m_nextSequence) {
+            m_lineReady.notify_one();
+        }
+    }
+
+    // Takes all the lines that are ready in order and prints them without
+    // holding the commit lock. Exits once the format threads have exited
+    // and their lines have been printed.
+    void printLines() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> lock(m_commitMutex);
+        for (;;) {
+            while (!m_ready[m_nextSequence % kReorderCapacity] && !m_formatted) {
+                m_lineReady.wait(lock);
+            }
+            size_t count = 0;
+            size_t slot = (size_t)(m_nextSequence % kReorderCapacity);
+            while (count < kReorderCapacity && m_ready[slot]) {
+                if (batch.size() == count) {
+                    batch.emplace_back();
+                }
+                // the strings are swapped back and forth to reuse their buffers
+                batch[count++].swap(m_lines[slot]);
+                m_ready[slot] = false;
+                slot = (slot + 1) % kReorderCapacity;
+            }
+            if (count == 0) {
+                return;
+            }
+            m_nextSequence += count;
+            if (m_waiting > 0) {
+                m_committed.notify_all();
+            }
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> writerLock(m_writerMutex);
+                for (size_t i = 0; i < count; i++) {
+                    print(batch[i]);
+                }
+            }
+            lock.lock();
+        }
+    }
+
+    void print(const std::string& line) {
+        if (line.empty()) {
+            m_dropped++;
+            return;
+        }
+        for (auto& writer : m_writers) {
+            writer->Print(line.data(), line.size());
+        }
+    }
+
+    void flush() {
         for (auto& writer : m_writers) {
-            writer->Print(level, timestamp, msg);
+            writer->Flush();
         }
     }
 
+    void format(const LogMessage& msg, TimestampCache* cache, std::string* line) {
+        char timestamp[32];
+        toString(msg.timestamp, cache, timestamp, sizeof(timestamp));
+        char header[64];
+        int size = snprintf(header, sizeof(header), "%c %s %llu ",
+                toCharacter(msg.level), timestamp, (unsigned long long)msg.threadID);
+        line->assign(header, size > 0 ? (size_t)size : 0);
+        line->append(msg.file);
+        line->push_back(':');
+        line->append(std::to_string(msg.line));
+        line->append(": ");
+        line->append(msg.content.get());
+        line->push_back('\n');
+    }
+
     char toCharacter(LogLevel level) {
         switch (level) {
             case LogLevel_TRACE: return 'T';
@@ -196,33 +429,39 @@ private:
         }
     }
 
-    void toString(const struct timeval& time, char* str, size_t size) {
+    void toString(const struct timeval& time, TimestampCache* cache, char* str, size_t size) {
         assert(size >= 25);
 
         time_t sec = time.tv_sec;
-        struct tm calendar;
-        localtime_r(&sec, &calendar);
-        strftime(str, size, "%y-%m-%d %H:%M:%S", &calendar);
+        if (sec != cache->second) {
+            struct tm calendar;
+            localtime_r(&sec, &calendar);
+            strftime(cache->prefix, sizeof(cache->prefix), "%y-%m-%d %H:%M:%S", &calendar);
+            cache->second = sec;
+        }
         const int offset = 17;
+        memcpy(str, cache->prefix, offset);
         snprintf(&str[offset], size - offset, ".%06ld", (long)time.tv_usec);
     }
 };
 
 struct StdoutLogWriter final : public LogWriter {
-    void Print(char level, const char* timestamp, const LogMessage& msg) {
-        // call printf 3 times to avoid a runtime error on Windows
-        printf("%c %s %ld ", level, timestamp, msg.threadID);
-        printf("%s:%d: ", msg.file, msg.line);
-        printf("%s\n", msg.content.get());
+    void Print(const char* line, size_t size) {
+        fwrite(line, 1, size, stdout);
+    }
+
+    void Flush() {
+        fflush(stdout);
     }
 };
 
 struct StderrLogWriter final : public LogWriter {
-    void Print(char level, const char* timestamp, const LogMessage& msg) {
-        // call fprintf 3 times to avoid a runtime error on Windows
-        fprintf(stderr, "%c %s %ld ", level, timestamp, msg.threadID);
-        fprintf(stderr, "%s:%d: ", msg.file, msg.line);
-        fprintf(stderr, "%s\n", msg.content.get());
+    void Print(const char* line, size_t size) {
+        fwrite(line, 1, size, stderr);
+    }
+
+    void Flush() {
+        fflush(stderr);
     }
 };
 
@@ -251,23 +490,19 @@ public:
         return true;
     }
 
-    void Print(char level, const char* timestamp, const LogMessage& msg) {
+    void Print(const char* line, size_t size) {
         if (m_output == nullptr) {
             return;
         }
 
         if (rotateLogFiles()) {
-            // call fprintf 3 times to avoid a runtime error on Windows
-            int size;
-            if ((size = fprintf(m_output, "%c %s %ld ", level, timestamp, msg.threadID)) > 0) {
-                m_currentFileSize += size;
-            }
-            if ((size = fprintf(m_output, "%s:%d: ", msg.file, msg.line)) > 0) {
-                m_currentFileSize += size;
-            }
-            if ((size = fprintf(m_output, "%s\n", msg.content.get())) > 0) {
-                m_currentFileSize += size;
-            }
+            m_currentFileSize += fwrite(line, 1, size, m_output);
+        }
+    }
+
+    void Flush() {
+        if (m_output != nullptr) {
+            fflush(m_output);
         }
     }
 
@@ -296,6 +531,7 @@ private:
                     fprintf(stderr, "ERROR: logger: Failed to rename file: `%s` -> `%s`\n", src.c_str(), dst.c_str());
                 }
             }
+            rotateIndexFile(src, dst);
         }
         m_output = fopen(m_filename.c_str(), "a");
         if (m_output == nullptr) {
@@ -306,6 +542,17 @@ private:
         return true;
     }
 
+    // Keep the search index of logsearch.h with its log file.
+    // The index is only a cache, so errors are ignored.
+    void rotateIndexFile(const std::string& src, const std::string& dst) {
+        std::string srcIndex = src + kIndexFileSuffix;
+        std::string dstIndex = dst + kIndexFileSuffix;
+        remove(dstIndex.c_str());
+        if (isFileExist(srcIndex)) {
+            rename(srcIndex.c_str(), dstIndex.c_str());
+        }
+    }
+
     std::string getBackupFileName(const std::string& basename, uint8_t index) {
         if (index == 0) {
             return basename;
@@ -333,13 +580,27 @@ private:
 namespace logger {
 
 LogLevel s_level = LogLevel_INFO;
-std::shared_ptr<LogThread> s_thread = std::make_shared<LogThread>();
+
+static void shutdownAtExit() {
+    Shutdown();
+}
+
+static LogThread* getLogThread() {
+    // Never destroyed so that it stays usable from other static destructors.
+    // The queue is drained by Shutdown() from an atexit handler instead.
+    static LogThread* thread = [] {
+        LogThread* t = new LogThread();
+        std::atexit(shutdownAtExit);
+        return t;
+    }();
+    return thread;
+}
 
 bool InitConsoleLogger(FILE* output) {
     if (output == stderr) {
-        s_thread->AddWriter(std::unique_ptr<StderrLogWriter>(new StderrLogWriter()));
+        getLogThread()->AddWriter(std::unique_ptr<StderrLogWriter>(new StderrLogWriter()));
     } else {
-        s_thread->AddWriter(std::unique_ptr<StdoutLogWriter>(new StdoutLogWriter()));
+        getLogThread()->AddWriter(std::unique_ptr<StdoutLogWriter>(new StdoutLogWriter()));
     }
     return true;
 }
@@ -349,10 +610,18 @@ bool InitFileLogger(const char* filename, int64_t maxFileSize, uint8_t maxBackup
     if (!writer->Init()) {
         return false;
     }
-    s_thread->AddWriter(std::move(writer));
+    getLogThread()->AddWriter(std::move(writer));
     return true;
 }
 
+bool SetFormatThreads(uint8_t count) {
+    return getLogThread()->SetThreadCount(count);
+}
+
+bool Shutdown(uint32_t timeoutMillis) {
+    return getLogThread()->Stop(std::chrono::milliseconds(timeoutMillis));
+}
+
 static uint64_t getCurrentThreadID();
 
 void Log(LogLevel level, const char* file, uint32_t line, const char* fmt, ...) {
@@ -371,7 +640,7 @@ void Log(LogLevel level, const char* file, uint32_t line, const char* fmt, ...)
         msg.file = file;
         msg.line = line;
         msg.content = std::unique_ptr<char>(buf);
-        s_thread->Send(std::move(msg));
+        getLogThread()->Send(std::move(msg));
     } else {
         fprintf(stderr, "ERROR: logger: vasprintf");
     }
@@ -30,9 +30,33 @@ enum LogLevel : uint8_t {
 
 bool InitConsoleLogger(FILE* output = stdout);
 bool InitFileLogger(const char* filename, int64_t maxFileSize, uint8_t maxBackupFiles);
+
+/**
+ * Set the number of threads that format messages in parallel.
+ * Messages are still written in the order they were logged.
+ * This must be called before the logger is initialized or used.
+ *
+ * @param[in] count The number of threads (1 if count is 0)
+ * @return true upon success or false if the logger has already started
+ */
+bool SetFormatThreads(uint8_t count);
+
 void SetLevel(LogLevel level);
 LogLevel GetLevel();
 bool IsEnabled(LogLevel level);
 void Log(LogLevel level, const char* file, uint32_t line, const char* fmt, ...);
 
+/**
+ * Stop the background logging threads after writing out the queued messages
+ * and flushing the outputs.
+ * Messages still queued when the timeout expires are discarded.
+ * Messages logged after this call, or while the queue is being drained, are
+ * written and flushed synchronously by the caller after the queued messages.
+ * This is called automatically at exit if the logger has been used.
+ *
+ * @param[in] timeoutMillis The maximum time to spend draining the queue
+ * @return true if all queued messages were written or false if some were discarded
+ */
+bool Shutdown(uint32_t timeoutMillis = 3000);
+
 } // namespace logger
@@ -101,6 +101,15 @@ static void parseLine(std::string& line, config* conf) {
     if (key == "level") {
         LogLevel level = parseLevel(val);
         SetLevel(level);
+    } else if (key == "formatThreads") {
+        int nthreads = atoi(val.c_str());
+        if (nthreads > 255) {
+            fprintf(stderr, "ERROR: loggerconf: Invalid formatThreads: `%s`\n", val.c_str());
+            nthreads = 255;
+        }
+        if (!SetFormatThreads((uint8_t) (nthreads > 0 ? nthreads : 1))) {
+            fprintf(stderr, "ERROR: loggerconf: formatThreads must be set before the logger starts: `%s`\n", val.c_str());
+        }
     } else if (key == "logger") {
         if (val == "console") {
             conf->loggerType |= kConsoleLogger;
@@ -15,6 +15,7 @@ namespace logger {
  * |logger.file.filename       |A output filename                            |
  * |logger.file.maxFileSize    |1-LONG_MAX [bytes] (1 MB if size <= 0)       |
  * |logger.file.maxBackupFiles |0-255                                        |
+ * |formatThreads              |1-255 (1 if threads <= 0)                    |
  *
  * @param[in] filename The name of the configuration file
  * @return true upon success or false on error
@@ -0,0 +1,543 @@
+#include "logsearch.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32) || defined(_WIN64)
+ #define NOMINMAX
+ #define WIN32_LEAN_AND_MEAN
+ #include <windows.h>
+#else
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif // defined(_WIN32) || defined(_WIN64)
+
+namespace logger {
+
+namespace {
+
+const char kIndexMagic[8] = {'L', 'O', 'G', 'I', 'D', 'X', '1', '\0'};
+const int64_t kIndexBlockSize = 262144L; // 256 KB
+const size_t kPrefixSize = 4096;
+const int kMaxBackupFiles = 255;
+
+// A log line starts with `L YY-MM-DD HH:MM:SS.uuuuuu TID `.
+const size_t kTimestampOffset = 2;
+const size_t kTimestampLength = 24;
+const size_t kThreadIDOffset = kTimestampOffset + kTimestampLength + 1;
+
+struct IndexEntry {
+    uint64_t offset;  // the start of a block, which is always the start of a line
+    uint64_t minTime;
+    uint64_t maxTime;
+    uint64_t levels;  // a bit for each level in the block
+};
+
+struct IndexHeader {
+    char magic[8];
+    uint64_t fileSize;
+    uint64_t prefixSize;
+    uint64_t prefixHash;
+    uint64_t count;
+};
+
+class MappedFile final {
+public:
+    MappedFile() : m_data(nullptr), m_size(0) {}
+
+    ~MappedFile() {
+        if (m_data == nullptr) {
+            return;
+        }
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile(m_data);
+#else
+        munmap((void*) m_data, m_size);
+#endif // defined(_WIN32) || defined(_WIN64)
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& filename) {
+#if defined(_WIN32) || defined(_WIN64)
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+        m_size = (size_t) size.QuadPart;
+        if (m_size > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                m_data = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, m_size);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        m_size = (size_t) st.st_size;
+        if (m_size > 0) {
+            void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                m_data = (const char*) addr;
+            }
+        }
+        close(fd);
+#endif // defined(_WIN32) || defined(_WIN64)
+        if (m_size > 0 && m_data == nullptr) {
+            fprintf(stderr, "ERROR: logsearch: Failed to map file: `%s`\n", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+struct Match {
+    size_t offset;
+    size_t size;
+};
+
+struct SearchResult {
+    std::unique_ptr<MappedFile> file;
+    std::vector<Match> matches;
+    bool ok;
+    bool done;
+
+    SearchResult() : ok(false), done(false) {}
+};
+
+} // namespace
+
+static bool parseDigits(const char* s, size_t n, uint64_t* value) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        *value = *value * 10 + (uint64_t) (s[i] - '0');
+    }
+    return true;
+}
+
+bool ParseTimestamp(const char* s, bool upper, uint64_t* key) {
+    // the separators between the fields of `YY-MM-DD HH:MM:SS.uuuuuu`
+    static const char kFormat[] = "00-00-00 00:00:00.000000";
+
+    if (s == nullptr || key == nullptr) {
+        return false;
+    }
+    size_t len = strlen(s);
+    if (len > kTimestampLength) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < kTimestampLength; i++) {
+        if (kFormat[i] != '0') {
+            if (i < len && s[i] != kFormat[i]) {
+                return false;
+            }
+            continue;
+        }
+        char c = i < len ? s[i] : (upper ? '9' : '0');
+        if (!parseDigits(&c, 1, &value)) {
+            return false;
+        }
+    }
+    *key = value;
+    return true;
+}
+
+static int parseLevel(char c) {
+    switch (c) {
+        case 'T': return LogLevel_TRACE;
+        case 'D': return LogLevel_DEBUG;
+        case 'I': return LogLevel_INFO;
+        case 'W': return LogLevel_WARN;
+        case 'E': return LogLevel_ERROR;
+        case 'F': return LogLevel_FATAL;
+        default: return -1;
+    }
+}
+
+// Returns false if the line is not in the log format.
+static bool parseHeader(const char* line, size_t size, int* level, uint64_t* timestamp) {
+    if (size < kThreadIDOffset || line[1] != ' ' || line[kThreadIDOffset - 1] != ' ') {
+        return false;
+    }
+    *level = parseLevel(line[0]);
+    if (*level < 0) {
+        return false;
+    }
+    const char* ts = &line[kTimestampOffset];
+    uint64_t value = 0;
+    if (!parseDigits(&ts[0], 2, &value) || !parseDigits(&ts[3], 2, &value)
+            || !parseDigits(&ts[6], 2, &value) || !parseDigits(&ts[9], 2, &value)
+            || !parseDigits(&ts[12], 2, &value) || !parseDigits(&ts[15], 2, &value)
+            || !parseDigits(&ts[18], 6, &value)) {
+        return false;
+    }
+    *timestamp = value;
+    return true;
+}
+
+static bool matchesLine(const char* line, size_t size, const SearchQuery& query) {
+    bool filtered = query.from > 0 || query.to < UINT64_MAX
+            || query.level > LogLevel_TRACE || query.threadID != 0;
+    if (!filtered) {
+        return true;
+    }
+    int level;
+    uint64_t timestamp;
+    if (!parseHeader(line, size, &level, &timestamp)) {
+        return false;
+    }
+    if (level < query.level || timestamp < query.from || timestamp > query.to) {
+        return false;
+    }
+    if (query.threadID != 0) {
+        uint64_t threadID = 0;
+        size_t i = kThreadIDOffset;
+        for (; i < size && line[i] >= '0' && line[i] <= '9'; i++) {
+            threadID = threadID * 10 + (uint64_t) (line[i] - '0');
+        }
+        if (i == kThreadIDOffset || threadID != query.threadID) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The substring must not be empty. memchr is vectorized by the common C
+// libraries while glibc's memmem is not, so the first byte is found with
+// memchr and only the candidates are compared.
+static const char* findSubstring(const char* begin, const char* end, const std::string& s) {
+    if ((size_t) (end - begin) < s.size()) {
+        return nullptr;
+    }
+    const char* last = end - s.size();
+    for (const char* p = begin; p <= last; p++) {
+        p = (const char*) memchr(p, s[0], (size_t) (last - p) + 1);
+        if (p == nullptr) {
+            return nullptr;
+        }
+        if (memcmp(p + 1, s.data() + 1, s.size() - 1) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+static const char* lineEnd(const char* p, const char* end) {
+    const char* nl = (const char*) memchr(p, '\n', (size_t) (end - p));
+    return nl != nullptr ? nl : end;
+}
+
+static void scanBlock(const char* data, size_t begin, size_t end, const SearchQuery& query,
+        std::vector<Match>* matches) {
+    const char* p = data + begin;
+    const char* last = data + end;
+    if (query.substring.empty()) {
+        while (p < last) {
+            const char* e = lineEnd(p, last);
+            if (matchesLine(p, (size_t) (e - p), query)) {
+                matches->push_back({(size_t) (p - data), (size_t) (e - p)});
+            }
+            p = e + 1;
+        }
+        return;
+    }
+    while (p < last) {
+        const char* hit = findSubstring(p, last, query.substring);
+        if (hit == nullptr) {
+            break;
+        }
+        const char* s = hit;
+        while (s > p && s[-1] != '\n') {
+            s--;
+        }
+        const char* e = lineEnd(hit, last);
+        if (hit + query.substring.size() <= e && matchesLine(s, (size_t) (e - s), query)) {
+            matches->push_back({(size_t) (s - data), (size_t) (e - s)});
+        }
+        p = e + 1;
+    }
+}
+
+static uint64_t hashPrefix(const char* data, size_t size) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Reads the entries that are still valid for the file, which may have grown since it was indexed.
+static bool readIndex(const std::string& filename, const MappedFile& file, std::vector<IndexEntry>* index,
+        uint64_t* fileSize) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    IndexHeader header;
+    bool valid = fread(&header, sizeof(header), 1, fp) == 1
+            && memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0
+            && header.fileSize <= file.Size()
+            && header.prefixSize <= header.fileSize
+            && header.prefixHash == hashPrefix(file.Data(), (size_t) header.prefixSize)
+            && header.count <= header.fileSize / kIndexBlockSize + 1;
+    if (valid) {
+        index->resize((size_t) header.count);
+        valid = header.count == 0 || fread(index->data(), sizeof(IndexEntry), index->size(), fp) == index->size();
+    }
+    // the blocks must start at 0 and be in order within the indexed size
+    for (size_t i = 0; valid && i < index->size(); i++) {
+        uint64_t offset = (*index)[i].offset;
+        valid = offset < header.fileSize && (i == 0 ? offset == 0 : offset > (*index)[i - 1].offset);
+    }
+    fclose(fp);
+    if (!valid) {
+        index->clear();
+        return false;
+    }
+    *fileSize = header.fileSize;
+    return true;
+}
+
+static uint64_t getProcessID() {
+#if defined(_WIN32) || defined(_WIN64)
+    return (uint64_t) GetCurrentProcessId();
+#else
+    return (uint64_t) getpid();
+#endif // defined(_WIN32) || defined(_WIN64)
+}
+
+// Writes to a temporary file first so that other searches never read a partial index.
+static void writeIndex(const std::string& filename, const MappedFile& file, const std::vector<IndexEntry>& index) {
+    std::string tmpFilename = filename + ".tmp." + std::to_string(getProcessID()) + "."
+            + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    FILE* fp = fopen(tmpFilename.c_str(), "wb");
+    if (fp == nullptr) {
+        return; // the index is only a cache
+    }
+    IndexHeader header;
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.fileSize = file.Size();
+    header.prefixSize = std::min(file.Size(), kPrefixSize);
+    header.prefixHash = hashPrefix(file.Data(), (size_t) header.prefixSize);
+    header.count = index.size();
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && (index.empty() || fwrite(index.data(), sizeof(IndexEntry), index.size(), fp) == index.size());
+    ok = fclose(fp) == 0 && ok;
+#if defined(_WIN32) || defined(_WIN64)
+    ok = ok && MoveFileExA(tmpFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmpFilename.c_str(), filename.c_str()) == 0;
+#endif // defined(_WIN32) || defined(_WIN64)
+    if (!ok) {
+        remove(tmpFilename.c_str());
+    }
+}
+
+// Indexes the file from the given offset, which must be the start of a line.
+static void buildIndex(const MappedFile& file, size_t offset, std::vector<IndexEntry>* index) {
+    const char* data = file.Data();
+    const char* last = data + file.Size();
+    const char* p = data + offset;
+    while (p < last) {
+        IndexEntry entry = {(uint64_t) (p - data), UINT64_MAX, 0, 0};
+        // p + kIndexBlockSize may lie beyond the mapping, so compare the sizes
+        const char* blockEnd = (size_t) (last - p) > (size_t) kIndexBlockSize ? p + kIndexBlockSize : last;
+        while (p < last && (p < blockEnd || entry.offset == (uint64_t) (p - data))) {
+            const char* e = lineEnd(p, last);
+            int level;
+            uint64_t timestamp;
+            if (parseHeader(p, (size_t) (e - p), &level, &timestamp)) {
+                entry.minTime = std::min(entry.minTime, timestamp);
+                entry.maxTime = std::max(entry.maxTime, timestamp);
+                entry.levels |= 1ULL << level;
+            }
+            p = e + 1;
+        }
+        index->push_back(entry);
+    }
+}
+
+static void loadIndex(const std::string& filename, const MappedFile& file, const SearchQuery& query,
+        std::vector<IndexEntry>* index) {
+    std::string indexFilename = filename + kIndexFileSuffix;
+    uint64_t indexedSize = 0;
+    if (query.useIndexFile && readIndex(indexFilename, file, index, &indexedSize)) {
+        if (indexedSize == file.Size()) {
+            return;
+        }
+    }
+    size_t offset = 0;
+    if (!index->empty()) {
+        // the last block may have been incomplete when it was indexed
+        offset = (size_t) index->back().offset;
+        index->pop_back();
+    }
+    buildIndex(file, offset, index);
+    if (query.useIndexFile) {
+        writeIndex(indexFilename, file, *index);
+    }
+}
+
+static bool mayMatch(const IndexEntry& entry, const SearchQuery& query) {
+    if ((query.from > 0 || query.to < UINT64_MAX)
+            && (entry.maxTime < query.from || entry.minTime > query.to)) {
+        return false;
+    }
+    if (query.level > LogLevel_TRACE && (entry.levels >> query.level) == 0) {
+        return false;
+    }
+    return true;
+}
+
+static bool searchFile(const std::string& filename, const MappedFile& file, const SearchQuery& query,
+        std::vector<Match>* matches) {
+    std::vector<IndexEntry> index;
+    loadIndex(filename, file, query, &index);
+    for (size_t i = 0; i < index.size(); i++) {
+        if (!mayMatch(index[i], query)) {
+            continue;
+        }
+        size_t end = i + 1 < index.size() ? (size_t) index[i + 1].offset : file.Size();
+        scanBlock(file.Data(), (size_t) index[i].offset, end, query, matches);
+    }
+    return true;
+}
+
+static bool isFileExist(const std::string& filename) {
+    FILE* fp;
+    if ((fp = fopen(filename.c_str(), "r")) == nullptr) {
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
+bool SearchLogFiles(const char* filename, const SearchQuery& query,
+        const std::function<void(const char* line, size_t size)>& callback) {
+    if (filename == nullptr) {
+        return false;
+    }
+
+    // from the oldest backup to the current file
+    std::vector<std::string> filenames;
+    for (int i = 1; i <= kMaxBackupFiles; i++) {
+        std::string backup = std::string(filename) + "." + std::to_string(i);
+        if (!isFileExist(backup)) {
+            break;
+        }
+        filenames.insert(filenames.begin(), backup);
+    }
+    if (isFileExist(filename)) {
+        filenames.push_back(filename);
+    }
+    if (filenames.empty()) {
+        fprintf(stderr, "ERROR: logsearch: Failed to open file: `%s`\n", filename);
+        return false;
+    }
+
+    // Files are searched in parallel, but at most nThreads files ahead of the
+    // oldest one not yet passed to the callback. Each file is unmapped as soon
+    // as its matches have been passed, so memory does not grow with the history.
+    size_t n = filenames.size();
+    size_t nThreads = std::min(n, (size_t) std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<SearchResult> results(n);
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next = 0;
+    size_t passed = 0;
+    auto worker = [&]() {
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (next < n && next >= passed + nThreads) {
+                    cond.wait(lock);
+                }
+                if (next >= n) {
+                    return;
+                }
+                i = next++;
+            }
+            SearchResult result;
+            result.file.reset(new MappedFile());
+            result.ok = result.file->Open(filenames[i])
+                    && searchFile(filenames[i], *result.file, query, &result.matches);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i] = std::move(result);
+                results[i].done = true;
+            }
+            cond.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; i++) {
+        threads.push_back(std::thread(worker));
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < n; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!results[i].done) {
+                cond.wait(lock);
+            }
+        }
+        // no worker touches this result any more
+        if (results[i].ok) {
+            for (const Match& m : results[i].matches) {
+                callback(results[i].file->Data() + m.offset, m.size);
+            }
+        } else {
+            ok = false;
+        }
+        results[i] = SearchResult();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            passed++;
+        }
+        cond.notify_all();
+    }
+    for (std::thread& th : threads) {
+        th.join();
+    }
+    return ok;
+}
+
+} // namespace logger
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "logger.h"
+
+namespace logger {
+
+// The suffix of the index file kept next to each log file.
+const char* const kIndexFileSuffix = ".idx";
+
+struct SearchQuery {
+    uint64_t from;         // inclusive timestamp key (see ParseTimestamp), 0 for no lower bound
+    uint64_t to;           // inclusive timestamp key, UINT64_MAX for no upper bound
+    LogLevel level;        // minimum level
+    uint64_t threadID;     // 0 for any thread
+    std::string substring; // empty for any content
+    bool useIndexFile;     // read and write the index files
+
+    SearchQuery()
+            : from(0)
+            , to(UINT64_MAX)
+            , level(LogLevel_TRACE)
+            , threadID(0)
+            , useIndexFile(true) {}
+};
+
+/**
+ * Convert a timestamp in the log format (`YY-MM-DD HH:MM:SS.uuuuuu`) to a key
+ * for SearchQuery. Trailing fields may be omitted. The missing digits are
+ * filled with the lowest value, or with the highest value if upper is true.
+ *
+ * @param[in] s The timestamp
+ * @param[in] upper true to make the key the end of the given period
+ * @param[out] key The timestamp key
+ * @return true upon success or false on error
+ */
+bool ParseTimestamp(const char* s, bool upper, uint64_t* key);
+
+/**
+ * Search a log file and the backups rotated by InitFileLogger().
+ * The files are memory-mapped and scanned in parallel. Each file has a sparse
+ * index of its blocks, which is built on the first search and kept in
+ * `<file>.idx`, so only the blocks that can match the time range and level
+ * are scanned.
+ * Matching lines are passed to the callback on the calling thread in order
+ * from the oldest file, without the trailing newline, as soon as that file
+ * and all older files have been searched. They are only valid during the callback.
+ *
+ * @param[in] filename The name of the current log file
+ * @param[in] query The conditions which every matching line satisfies
+ * @param[in] callback The function to be called with each matching line
+ * @return true upon success or false on error
+ */
+bool SearchLogFiles(const char* filename, const SearchQuery& query,
+        const std::function<void(const char* line, size_t size)>& callback);
+
+} // namespace logger
@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "logger.h"
+#include "test.h"
+
+static const char* kFilename = "logger_order_test.log";
+static const int kLoggingCount = 100000;
+static const uint8_t kFormatThreads = 4;
+
+int main(void) {
+    remove(kFilename);
+    CHECK(logger::SetFormatThreads(kFormatThreads));
+    CHECK(logger::InitFileLogger(kFilename, (int64_t) 1 << 40, 0));
+    CHECK(!logger::SetFormatThreads(1)); // too late once the logger has started
+    for (int i = 0; i < kLoggingCount; i++) {
+        LOG_INFO("%d", i);
+    }
+    CHECK(logger::Shutdown(60000));
+    LOG_INFO("%d", kLoggingCount); // written synchronously after shutdown
+
+    FILE* fp = fopen(kFilename, "r");
+    CHECK(fp != nullptr);
+    char line[256];
+    int expected = 0;
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        const char* content = strrchr(line, ' ');
+        CHECK(content != nullptr);
+        CHECK(atoi(content + 1) == expected);
+        expected++;
+    }
+    fclose(fp);
+    CHECK(expected == kLoggingCount + 1);
+    remove(kFilename);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "logger.h"
+#include "test.h"
+
+static const char* kFilename = "logger_reorder_test.log";
+static const int kRounds = 5;
+static const int kSmallCount = 20000; // much more than the reorder capacity of 1000
+static const size_t kLargeSize = 32 * 1048576; // 32 MB
+static const uint8_t kFormatThreads = 4;
+
+// One thread spends a long time formatting a large message, while the other
+// threads format the small messages behind it. They fill the reorder buffer
+// and have to wait for the large message to be printed.
+int main(void) {
+    remove(kFilename);
+    CHECK(logger::SetFormatThreads(kFormatThreads));
+    CHECK(logger::InitFileLogger(kFilename, (int64_t) 1 << 40, 0));
+    std::string large(kLargeSize, 'x');
+    int n = 0;
+    for (int round = 0; round < kRounds; round++) {
+        LOG_INFO("%d %s", n++, large.c_str());
+        for (int i = 0; i < kSmallCount; i++) {
+            LOG_INFO("%d", n++);
+        }
+    }
+    CHECK(logger::Shutdown(600000));
+
+    FILE* fp = fopen(kFilename, "r");
+    CHECK(fp != nullptr);
+    std::string line;
+    int expected = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF) {
+        if (c != '\n') {
+            line.push_back((char) c);
+            continue;
+        }
+        // `L YY-MM-DD HH:MM:SS.uuuuuu TID file:line: N [x...]`
+        size_t pos = line.find(": ");
+        CHECK(pos != std::string::npos);
+        CHECK(atoi(line.c_str() + pos + 2) == expected);
+        if (expected % (kSmallCount + 1) == 0) {
+            CHECK(line.size() > kLargeSize);
+        }
+        expected++;
+        line.clear();
+    }
+    fclose(fp);
+    CHECK(expected == n);
+    remove(kFilename);
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "logger.h"
+#include "logsearch.h"
+#include "test.h"
+
+static const char* kFilename = "logsearch_test.log";
+static const char* kRotatedFilename = "logsearch_test_rotated.log";
+static const int kLineCount = 20000; // about 1 MB, or several index blocks
+static const int kErrorLines = 1000; // ERROR lines only appear in the first block
+static const int kChangedLevelLine = 15000;
+static const int kChangedTimeLine = 16000;
+
+static std::string indexFilename(const char* filename) {
+    return std::string(filename) + logger::kIndexFileSuffix;
+}
+
+static bool isFileExist(const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (fp == nullptr) {
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
+// Every line has the same length and line i is logged at i seconds after midnight.
+static std::string makeLine(int i, char level) {
+    char line[128];
+    snprintf(line, sizeof(line), "%c 26-10-19 %02d:%02d:%02d.000000 100 f.cpp:1: message %06d\n",
+            level, i / 3600, i / 60 % 60, i % 60, i);
+    return line;
+}
+
+static char levelOf(int i) {
+    return i < kErrorLines && i % 100 == 0 ? 'E' : 'I';
+}
+
+static size_t writeLogFile(const char* filename, int from, int to) {
+    FILE* fp = fopen(filename, from == 0 ? "w" : "a");
+    CHECK(fp != nullptr);
+    for (int i = from; i < to; i++) {
+        fputs(makeLine(i, levelOf(i)).c_str(), fp);
+    }
+    fclose(fp);
+    return makeLine(0, 'I').size();
+}
+
+static void overwrite(const char* filename, long offset, const char* s) {
+    FILE* fp = fopen(filename, "r+b");
+    CHECK(fp != nullptr);
+    CHECK(fseek(fp, offset, SEEK_SET) == 0);
+    CHECK(fwrite(s, 1, strlen(s), fp) == strlen(s));
+    fclose(fp);
+}
+
+static std::vector<std::string> search(const char* filename, const logger::SearchQuery& query) {
+    std::vector<std::string> lines;
+    CHECK(logger::SearchLogFiles(filename, query, [&](const char* line, size_t size) {
+        lines.push_back(std::string(line, size));
+    }));
+    return lines;
+}
+
+static logger::SearchQuery levelQuery(logger::LogLevel level, bool useIndexFile) {
+    logger::SearchQuery query;
+    query.level = level;
+    query.useIndexFile = useIndexFile;
+    return query;
+}
+
+static void testParseTimestamp() {
+    uint64_t key;
+    CHECK(logger::ParseTimestamp("26-10-19 12:34:56.789012", false, &key));
+    CHECK(key == 261019123456789012ULL);
+    CHECK(logger::ParseTimestamp("26-10-19 12", false, &key));
+    CHECK(key == 261019120000000000ULL);
+    CHECK(logger::ParseTimestamp("26-10-19 12", true, &key));
+    CHECK(key == 261019129999999999ULL);
+    CHECK(logger::ParseTimestamp("26-10-19 12:34:5", true, &key));
+    CHECK(key == 261019123459999999ULL);
+    CHECK(!logger::ParseTimestamp("26/10/19", false, &key));
+    CHECK(!logger::ParseTimestamp("26-10-19 12:34:56.7890123", false, &key));
+    CHECK(!logger::ParseTimestamp("26-1x", false, &key));
+}
+
+// A changed line is only found if its block is scanned, which shows whether
+// the index made the search skip the block.
+static void testIndex() {
+    remove(kFilename);
+    remove(indexFilename(kFilename).c_str());
+    size_t lineSize = writeLogFile(kFilename, 0, kLineCount);
+
+    // the first search builds the index
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, true)).size() == kErrorLines / 100);
+    CHECK(isFileExist(indexFilename(kFilename)));
+
+    // blocks without ERROR lines are skipped
+    overwrite(kFilename, (long) (kChangedLevelLine * lineSize), "E");
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, true)).size() == kErrorLines / 100);
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, false)).size() == kErrorLines / 100 + 1);
+
+    // blocks outside the time range are skipped
+    overwrite(kFilename, (long) (kChangedTimeLine * lineSize + 11), "00:00:05");
+    logger::SearchQuery query;
+    CHECK(logger::ParseTimestamp("26-10-19 00:00:05", false, &query.from));
+    CHECK(logger::ParseTimestamp("26-10-19 00:00:05", true, &query.to));
+    CHECK(search(kFilename, query).size() == 1);
+    query.useIndexFile = false;
+    CHECK(search(kFilename, query).size() == 2);
+
+    // the index is reused after the file grows, and the new lines are indexed
+    writeLogFile(kFilename, kLineCount, kLineCount + 10);
+    overwrite(kFilename, (long) ((kLineCount + 5) * lineSize), "E");
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, true)).size() == kErrorLines / 100 + 1);
+
+    // an index whose blocks are not in order is rejected and rebuilt
+    FILE* fp = fopen(indexFilename(kFilename).c_str(), "r+b");
+    CHECK(fp != nullptr);
+    const long secondOffset = 5 * sizeof(uint64_t) + 4 * sizeof(uint64_t); // header + first entry
+    uint64_t bogus = UINT64_MAX / 2;
+    CHECK(fseek(fp, secondOffset, SEEK_SET) == 0);
+    CHECK(fwrite(&bogus, sizeof(bogus), 1, fp) == 1);
+    fclose(fp);
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, true)).size() == kErrorLines / 100 + 2);
+
+    // a stale index, for a file with a different beginning, is rejected and rebuilt
+    writeLogFile(kFilename, 0, kLineCount);
+    search(kFilename, levelQuery(logger::LogLevel_ERROR, true));
+    overwrite(kFilename, (long) (kChangedLevelLine * lineSize), "E");
+    overwrite(kFilename, 0, "W");
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_ERROR, true)).size() == kErrorLines / 100);
+    CHECK(search(kFilename, levelQuery(logger::LogLevel_WARN, true)).size() == kErrorLines / 100 + 1);
+
+    remove(kFilename);
+    remove(indexFilename(kFilename).c_str());
+}
+
+// FileLogWriter keeps each index file with its log file when it rotates them.
+static void testRotation() {
+    const std::string backup = std::string(kRotatedFilename) + ".1";
+    remove(kRotatedFilename);
+    remove(backup.c_str());
+    remove(indexFilename(kRotatedFilename).c_str());
+    remove(indexFilename(backup.c_str()).c_str());
+
+    CHECK(logger::InitFileLogger(kRotatedFilename, 4096, 1));
+    logger::Shutdown(); // log synchronously so that the files are written at once
+    int n = 0;
+    for (; n < 10; n++) {
+        LOG_INFO("message %d", n);
+    }
+    CHECK(search(kRotatedFilename, logger::SearchQuery()).size() == 10);
+    CHECK(isFileExist(indexFilename(kRotatedFilename)));
+    CHECK(!isFileExist(backup));
+
+    while (!isFileExist(backup)) {
+        LOG_INFO("message %d", n++);
+    }
+    CHECK(!isFileExist(indexFilename(kRotatedFilename)));
+    CHECK(isFileExist(indexFilename(backup.c_str())));
+    std::vector<std::string> lines = search(kRotatedFilename, logger::SearchQuery());
+    CHECK((int) lines.size() == n);
+    for (int i = 0; i < n; i++) {
+        std::string suffix = "message " + std::to_string(i);
+        CHECK(lines[i].compare(lines[i].size() - suffix.size(), suffix.size(), suffix) == 0);
+    }
+
+    remove(kRotatedFilename);
+    remove(backup.c_str());
+    remove(indexFilename(kRotatedFilename).c_str());
+    remove(indexFilename(backup.c_str()).c_str());
+}
+
+int main(void) {
+    testParseTimestamp();
+    testIndex();
+    testRotation();
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "logsearch.h"
+
+static void printUsage(const char* program) {
+    printf("usage: %s [options] <log file>\n", program);
+    printf("  -f <time>      from `YY-MM-DD HH:MM:SS.uuuuuu` (trailing fields may be omitted)\n");
+    printf("  -t <time>      to `YY-MM-DD HH:MM:SS.uuuuuu` (trailing fields may be omitted)\n");
+    printf("  -l <level>     minimum level: TRACE, DEBUG, INFO, WARN, ERROR or FATAL\n");
+    printf("  -p <thread ID> thread ID\n");
+    printf("  -s <string>    substring of the line\n");
+    printf("  -n             neither read nor write the index files\n");
+}
+
+static bool parseLevel(const char* s, logger::LogLevel* level) {
+    static const char* const kLevels[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    for (int i = 0; i <= logger::LogLevel_FATAL; i++) {
+        if (strcmp(s, kLevels[i]) == 0) {
+            *level = (logger::LogLevel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    logger::SearchQuery query;
+    const char* filename = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "-n") == 0) {
+            query.useIndexFile = false;
+            continue;
+        }
+        if (opt[0] != '-') {
+            filename = opt;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* val = argv[++i];
+        bool ok = true;
+        if (strcmp(opt, "-f") == 0) {
+            ok = logger::ParseTimestamp(val, false, &query.from);
+        } else if (strcmp(opt, "-t") == 0) {
+            ok = logger::ParseTimestamp(val, true, &query.to);
+        } else if (strcmp(opt, "-l") == 0) {
+            ok = parseLevel(val, &query.level);
+        } else if (strcmp(opt, "-p") == 0) {
+            query.threadID = strtoull(val, nullptr, 10);
+        } else if (strcmp(opt, "-s") == 0) {
+            query.substring = val;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "ERROR: logsearch: Invalid option: `%s %s`\n", opt, val);
+            return 1;
+        }
+    }
+    if (filename == nullptr) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    bool ok = logger::SearchLogFiles(filename, query, [](const char* line, size_t size) {
+        fwrite(line, 1, size, stdout);
+        fputc('\n', stdout);
+    });
+    return ok ? 0 : 1;
+}